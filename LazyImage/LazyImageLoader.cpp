@@ -23,8 +23,10 @@
  ****************************************************************************/
 
 #include "LazyImageLoader.h"
+#include "LazyImageTrace.h"
 
 #include <algorithm>
+#include <cmath>
 
 #define kCacheDir   "LazyImageCache/"
 #define kCacheFile   "imageCacheInfo.txt"
@@ -59,6 +61,8 @@ bool LazyImageLoader::init()
 {
     _writablePath = FileUtils::getInstance()->getWritablePath();
     
+    _urlVariantBuckets = {64, 128, 256, 512, 1024};
+    
     std::string ownDirPath =  _writablePath + std::string(kCacheDir);
     
     if (!FileUtils::getInstance()->createDirectory(ownDirPath.c_str()))
@@ -110,6 +114,11 @@ void LazyImageLoader::deleteExpiredImages()
     }
     
     _cacheInfoFileValue = tempMap;
+    
+    _cachedURLs.clear();
+    for (auto& kv : _cacheInfoFileValue) {
+        _cachedURLs.insert(kv.first);
+    }
     FileUtils::getInstance()->writeValueMapToFile(_cacheInfoFileValue, _writablePath + _writePathPrefix + kCacheFile);
 }
 
@@ -233,18 +242,134 @@ std::vector<std::string> LazyImageLoader::split(const std::string& str, char del
     return internal;
 }
 
+#pragma mark - variant
+
+void LazyImageLoader::setURLVariantResolver(const ImageURLVariantResolver &resolver)
+{
+    _urlVariantResolver = resolver;
+}
+
+void LazyImageLoader::setURLVariantBuckets(const std::vector<int> &sizes)
+{
+    _urlVariantBuckets = sizes;
+    std::sort(_urlVariantBuckets.begin(), _urlVariantBuckets.end());
+}
+
+ImageURLVariantResolver LazyImageLoader::queryURLVariantResolver(const std::string &widthName, const std::string &heightName)
+{
+    return [widthName, heightName](const std::string& url, int width, int height) -> std::string {
+        char separator = url.find('?') == std::string::npos ? '?' : '&';
+        std::string variant = StringUtils::format("%s%c%s=%d", url.c_str(), separator, widthName.c_str(), width);
+        if(heightName.length() != 0){
+            variant.append(StringUtils::format("&%s=%d", heightName.c_str(), height));
+        }
+        return variant;
+    };
+}
+
+std::string LazyImageLoader::resolveURL(const std::string &url, const cocos2d::Size &size)
+{
+    if(!_urlVariantResolver || url.length() == 0){
+        return url;
+    }
+    
+    //size of slot in pixel
+    float scaleFactor = Director::getInstance()->getContentScaleFactor();
+    float width = size.width * scaleFactor;
+    float height = size.height * scaleFactor;
+    if(width <= 0 || height <= 0){
+        return url;
+    }
+    
+    auto widthBucket = std::lower_bound(_urlVariantBuckets.begin(), _urlVariantBuckets.end(), (int)std::ceil(width));
+    auto heightBucket = std::lower_bound(_urlVariantBuckets.begin(), _urlVariantBuckets.end(), (int)std::ceil(height));
+    if(widthBucket == _urlVariantBuckets.end() || heightBucket == _urlVariantBuckets.end()){
+        return url;
+    }
+    
+    //reuse the smallest larger image already cached instead of loading new one,
+    //candidates are checked in memory since this runs on every setImageURL,
+    //only the chosen one is checked on disk
+    while(true){
+        std::string cachedVariant;
+        long cachedArea = 0;
+        for (auto w = widthBucket; w != _urlVariantBuckets.end(); w ++) {
+            for (auto h = heightBucket; h != _urlVariantBuckets.end(); h ++) {
+                long area = (long)(*w) * (*h);
+                if(cachedVariant.length() != 0 && area >= cachedArea){
+                    continue;
+                }
+                std::string variant = _urlVariantResolver(url, *w, *h);
+                if(_cachedURLs.find(variant) != _cachedURLs.end()){
+                    cachedVariant = variant;
+                    cachedArea = area;
+                }
+            }
+        }
+        if(cachedVariant.length() == 0){
+            break;
+        }
+        if(pathForLoadedImage(cachedVariant).length() != 0){
+            return cachedVariant;
+        }
+        //file removed behind loader, forget it and look again
+        _cachedURLs.erase(cachedVariant);
+    }
+    if(_cachedURLs.find(url) != _cachedURLs.end()){
+        if(pathForLoadedImage(url).length() != 0){
+            return url;
+        }
+        _cachedURLs.erase(url);
+    }
+    
+    return _urlVariantResolver(url, *widthBucket, *heightBucket);
+}
+
 #pragma mark - downloader
 
 void LazyImageLoader::saveCacheInfo(const std::string &url,double cacheDuration)
 {
     auto currentTime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     _cacheInfoFileValue[url] = cacheDuration >= 0 ? (double)currentTime + cacheDuration : -1;
+    _cachedURLs.insert(url);
     FileUtils::getInstance()->writeValueMapToFile(_cacheInfoFileValue, _writablePath + _writePathPrefix + kCacheFile);
     CCLOG("LazyImageLoader:: cache %s done for %f seconds", url.c_str(), cacheDuration);
 }
 
+void LazyImageLoader::removeCachedImages(const std::string &url)
+{
+    removeCachedImages(std::vector<std::string>{url});
+}
+
+void LazyImageLoader::removeCachedImages(const std::vector<std::string> &baseURLs)
+{
+    std::vector<std::string> urls;
+    for (auto& url : baseURLs) {
+        urls.push_back(url);
+        if(_urlVariantResolver){
+            for (int width : _urlVariantBuckets) {
+                for (int height : _urlVariantBuckets) {
+                    urls.push_back(_urlVariantResolver(url, width, height));
+                }
+            }
+        }
+    }
+    
+    for (auto& u : urls) {
+        std::string path = pathForLoadedImage(u);
+        if(path.length() != 0){
+            Director::getInstance()->getTextureCache()->removeTextureForKey(path);
+            FileUtils::getInstance()->removeFile(path);
+        }
+        _cacheInfoFileValue.erase(u);
+        _cachedURLs.erase(u);
+    }
+    FileUtils::getInstance()->writeValueMapToFile(_cacheInfoFileValue, _writablePath + _writePathPrefix + kCacheFile);
+}
+
 bool LazyImageLoader::loadImage(const std::string &url,double cacheDuration)
 {
+    LazyImageTrace::getInstance()->recordLoadImage(url, cacheDuration);
     
     std::string filePath = convertURLToFilePath(url);
     if(filePath.size() == 0){
@@ -276,13 +401,21 @@ bool LazyImageLoader::loadImage(const std::string &url,double cacheDuration)
     
     _loadersIdentifier.push_back(loadInfo);
     
-    _downloader->createDownloadFileTask(url, fullPath, iden);
+    LazyImageTrace::getInstance()->noteDownload(url);
+    if(_downloadTaskCreator){
+        _downloadTaskCreator(url, fullPath, iden);
+    }else{
+        _downloader->createDownloadFileTask(url, fullPath, iden);
+    }
     
     return true;
 }
 
 void LazyImageLoader::onDownloadTaskDone(const cocos2d::network::DownloadTask &task)
 {
+    LazyImageTraceScope traceScope;
+    LazyImageTrace::getInstance()->noteDecode(task.requestURL);
+    
     Image* img = new Image();
     if(!img->initWithImageFile(task.storagePath)){
         //init file failed
@@ -332,6 +465,7 @@ void LazyImageLoader::onDownloadTaskFailed(const cocos2d::network::DownloadTask
                                            int errorCodeInternal,
                                            const std::string &errorStr)
 {
+    LazyImageTraceScope traceScope;
     CCLOG("LazyImageLoader:: load %s failed: %d %d %s",
           task.requestURL.c_str(), errorCode, errorCodeInternal, errorStr.c_str());
     
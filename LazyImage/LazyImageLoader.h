@@ -28,6 +28,8 @@
 #include "cocos2d.h"
 #include "network/CCDownloader.h"
 
+#include <unordered_set>
+
 #define EVENT_LAZY_IMAGE_DONE   "lziml"
 
 class ImageLoaderEvent : public cocos2d::EventCustom {
@@ -40,6 +42,9 @@ public:
     CC_SYNTHESIZE(cocos2d::Texture2D *, _texture, Texture);
 };
 
+/** map base url & bucket size in pixel to url of resized variant on server */
+typedef std::function<std::string(const std::string& url, int width, int height)> ImageURLVariantResolver;
+
 typedef struct ImageLoadInfo {
     
     std::string url;
@@ -49,6 +54,7 @@ typedef struct ImageLoadInfo {
 
 
 class LazyImageLoader  {
+    friend class LazyImageReplay;
 protected:
     LazyImageLoader();
     
@@ -74,6 +80,28 @@ public:
     
     void deleteExpiredImages();
     void saveCacheInfo(const std::string &url,double cacheDuration);
+    /** remove cached image of url and of all its size variants, from disk and TextureCache */
+    void removeCachedImages(const std::string& url);
+    /** same as above for many urls, cache info is written once */
+    void removeCachedImages(const std::vector<std::string>& urls);
+    
+    /** set resolver for size variant url, nullptr to always load base url */
+    void setURLVariantResolver(const ImageURLVariantResolver& resolver);
+    /** sizes of variants in pixel, target width & height are each rounded up to one of them
+     *  target larger than all buckets loads base url
+     */
+    void setURLVariantBuckets(const std::vector<int>& sizes);
+    /** resolver append "widthName=width" and "heightName=height" to query of url,
+     *  ex: queryURLVariantResolver("w", "h"). Without heightName server only knows the width,
+     *  so an image wider than its slot may still come back shorter than slot height
+     */
+    static ImageURLVariantResolver queryURLVariantResolver(const std::string& widthName, const std::string& heightName = "");
+    
+    /** url to load for image displayed in size (in points)
+     *  @return cached variant not smaller than size with fewest pixels, or base url if it is cached,
+     *  or variant of bucket for size, or base url if no resolver
+     */
+    std::string resolveURL(const std::string& url, const cocos2d::Size& size);
     
 private:
     std::vector<ImageLoadInfo> _loadersIdentifier;
@@ -81,6 +109,10 @@ private:
     std::string _writePathPrefix;
     bool _useOwnFolder;
     cocos2d::network::Downloader *_downloader;
+    // stand-in for _downloader, set by LazyImageReplay
+    std::function<void(const std::string& url, const std::string& storagePath, const std::string& identifier)> _downloadTaskCreator;
+    ImageURLVariantResolver _urlVariantResolver;
+    std::vector<int> _urlVariantBuckets;
     
     void onDownloadTaskDone(const cocos2d::network::DownloadTask& task);
     void onDownloadTaskFailed(const cocos2d::network::DownloadTask& task,
@@ -93,6 +125,8 @@ private:
 private:
     void createDirectoryForPath(const std::string& path);
     cocos2d::ValueMap _cacheInfoFileValue;
+    // urls in _cacheInfoFileValue, to check cache without touching file system
+    std::unordered_set<std::string> _cachedURLs;
 
 };
 
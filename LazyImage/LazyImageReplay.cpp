@@ -0,0 +1,375 @@
+/****************************************************************************
+ Copyright (c) 2016 QuanNguyen
+
+ http://quannguyen.info
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#include "LazyImageReplay.h"
+
+#include "LazyImageLoader.h"
+#include "LazySprite.h"
+
+#include <sstream>
+
+USING_NS_CC;
+
+LazyImageReplay::LazyImageReplay()
+: _nextEvent(0)
+, _running(false)
+{
+
+}
+
+LazyImageReplay::~LazyImageReplay()
+{
+
+}
+
+LazyImageReplay* LazyImageReplay::create(const LazyImageReplayConfig& config)
+{
+    LazyImageReplay *r = new LazyImageReplay();
+    if(r && r->init(config)){
+        r->autorelease();
+        return r;
+    }
+
+    CC_SAFE_DELETE(r);
+    return nullptr;
+}
+
+LazyImageReplayConfig LazyImageReplay::defaultConfig()
+{
+    LazyImageReplayConfig config;
+    config.latency = 0.1;
+    config.bandwidth = 512 * 1024;
+    config.maxProcessingTasks = 10;
+    config.coldCache = true;
+    return config;
+}
+
+bool LazyImageReplay::init(const LazyImageReplayConfig& config)
+{
+    if(!Node::init()){
+        return false;
+    }
+
+    _config = config;
+    if(_config.sourceDir.size() != 0 && _config.sourceDir.at(_config.sourceDir.size() - 1) != '/'){
+        _config.sourceDir.append("/");
+    }
+    if(_config.maxProcessingTasks <= 0){
+        _config.maxProcessingTasks = 1;
+    }
+
+    if(!FileUtils::getInstance()->isFileExist(_config.holderImage)){
+        CCLOG("LazyImageReplay: holder image %s not found", _config.holderImage.c_str());
+        return false;
+    }
+
+    if(!loadTrace(_config.tracePath)){
+        return false;
+    }
+
+    if(_config.coldCache){
+        std::vector<std::string> urls;
+        for (auto& kv : _urls) {
+            urls.push_back(kv.second);
+        }
+        LazyImageLoader::getInstance()->removeCachedImages(urls);
+    }
+
+    return true;
+}
+
+bool LazyImageReplay::loadTrace(const std::string &path)
+{
+    std::string content = FileUtils::getInstance()->getStringFromFile(path);
+    std::stringstream ss(content);
+    std::string line;
+
+    if(!getline(ss, line) || line != LAZY_IMAGE_TRACE_HEADER){
+        CCLOG("LazyImageReplay: %s is not a trace file", path.c_str());
+        return false;
+    }
+
+    long long time = 0;
+    while(getline(ss, line)) {
+        if(line.size() == 0){
+            continue;
+        }
+
+        std::stringstream ls(line);
+        char op = 0;
+        ls >> op;
+
+        if(op == 'u'){
+            int urlId = 0;
+            std::string url;
+            //url is rest of line, it may contain spaces
+            ls >> urlId;
+            getline(ls >> std::ws, url);
+            _urls[urlId] = url;
+            continue;
+        }
+
+        long long dt = 0;
+        ls >> dt;
+        time += dt;
+
+        Event event = {op, time, 0, 0, 0, Size::ZERO};
+        switch (op) {
+            case 'n':
+                ls >> event.spriteId >> event.size.width >> event.size.height;
+                break;
+            case 's':
+                ls >> event.spriteId >> event.urlId >> event.cacheDuration;
+                break;
+            case 'r':
+            case 'e':
+            case 'x':
+                ls >> event.spriteId;
+                break;
+            case 'l':
+                ls >> event.urlId >> event.cacheDuration;
+                break;
+            default:
+                CCLOG("LazyImageReplay: unknown event %s", line.c_str());
+                continue;
+        }
+
+        if(ls.fail()){
+            CCLOG("LazyImageReplay: bad event %s", line.c_str());
+            return false;
+        }
+        _events.push_back(event);
+    }
+
+    CCLOG("LazyImageReplay: %d events, %d urls from %s", (int)_events.size(), (int)_urls.size(), path.c_str());
+    return true;
+}
+
+#pragma mark - replay
+
+void LazyImageReplay::onEnter()
+{
+    Node::onEnter();
+
+    LazyImageLoader::getInstance()->_downloadTaskCreator = std::bind(&LazyImageReplay::createDownloadTask, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+
+    LazyImageTrace::getInstance()->resetStats();
+    LazyImageTrace::getInstance()->setCollectingStats(true);
+
+    _nextEvent = 0;
+    _startTime = std::chrono::steady_clock::now();
+    _running = true;
+    scheduleUpdate();
+}
+
+void LazyImageReplay::onExit()
+{
+    if(_running){
+        CCLOG("LazyImageReplay: exit before replay finished");
+        _running = false;
+        LazyImageTrace::getInstance()->setCollectingStats(false);
+    }
+    //fail pending transfers so loader does not keep them as downloading
+    LazyImageLoader *loader = LazyImageLoader::getInstance();
+    std::vector<Transfer> pendingTransfers(_activeTransfers.begin(), _activeTransfers.end());
+    pendingTransfers.insert(pendingTransfers.end(), _waitingTransfers.begin(), _waitingTransfers.end());
+    _waitingTransfers.clear();
+    _activeTransfers.clear();
+    for (auto& transfer : pendingTransfers) {
+        network::DownloadTask task;
+        task.requestURL = transfer.url;
+        task.storagePath = transfer.storagePath;
+        task.identifier = transfer.identifier;
+        loader->onDownloadTaskFailed(task, network::DownloadTask::ERROR_FILE_OP_FAILED, 0, "replay stopped");
+    }
+    loader->_downloadTaskCreator = nullptr;
+
+    Node::onExit();
+}
+
+double LazyImageReplay::elapsedSeconds()
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _startTime;
+    return elapsed.count();
+}
+
+void LazyImageReplay::update(float dt)
+{
+    if(!_running){
+        return;
+    }
+
+    double now = elapsedSeconds();
+
+    //finish transfers first, same as Downloader callbacks come before this frame
+    std::vector<Transfer> doneTransfers;
+    auto ite = _activeTransfers.begin();
+    while(ite != _activeTransfers.end()){
+        if(ite->finishTime <= now){
+            doneTransfers.push_back(*ite);
+            ite = _activeTransfers.erase(ite);
+        }else{
+            ite ++;
+        }
+    }
+    for (auto& transfer : doneTransfers) {
+        finishTransfer(transfer);
+    }
+
+    long long nowMilliseconds = (long long)(now * 1000);
+    while(_nextEvent < _events.size() && _events.at(_nextEvent).time <= nowMilliseconds){
+        runEvent(_events.at(_nextEvent));
+        _nextEvent ++;
+    }
+
+    startWaitingTransfers();
+    LazyImageTrace::getInstance()->sampleMemory();
+
+    if(_nextEvent == _events.size() && _waitingTransfers.empty() && _activeTransfers.empty()){
+        finish();
+    }
+}
+
+void LazyImageReplay::runEvent(const Event &event)
+{
+    if(event.op == 'n'){
+        Sprite *holder = Sprite::create(_config.holderImage);
+        LazySprite *sprite = LazySprite::create(holder, event.size);
+        _sprites.insert(event.spriteId, sprite);
+        return;
+    }
+
+    if(event.op == 'l'){
+        LazyImageLoader::getInstance()->loadImage(_urls[event.urlId], event.cacheDuration);
+        return;
+    }
+
+    LazySprite *sprite = _sprites.at(event.spriteId);
+    if(!sprite){
+        CCLOG("LazyImageReplay: unknown sprite %d", event.spriteId);
+        return;
+    }
+
+    switch (event.op) {
+        case 's':
+            sprite->setImageURL(_urls[event.urlId], event.cacheDuration);
+            break;
+        case 'r':
+            sprite->reset();
+            break;
+        case 'e':
+            if(sprite->getParent() == nullptr){
+                addChild(sprite);
+            }
+            break;
+        case 'x':
+            if(sprite->getParent() == this){
+                removeChild(sprite, false);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void LazyImageReplay::finish()
+{
+    _running = false;
+    unscheduleUpdate();
+
+    LazyImageTraceStats stats = LazyImageTrace::getInstance()->getStats();
+    LazyImageTrace::getInstance()->setCollectingStats(false);
+
+    logReport(stats);
+    if(onFinished){
+        onFinished(stats);
+    }
+}
+
+void LazyImageReplay::logReport(const LazyImageTraceStats &stats)
+{
+    //log instead of CCLOG, report is needed in release builds too
+    log("LazyImageReplay: time to display (%d) p50 %.1fms p90 %.1fms p99 %.1fms max %.1fms",
+        (int)stats.timeToDisplay.size(),
+        stats.percentile(50) * 1000, stats.percentile(90) * 1000,
+        stats.percentile(99) * 1000, stats.percentile(100) * 1000);
+    log("LazyImageReplay: downloads %d (redundant %d), decodes %d (redundant %d)",
+        stats.downloads, stats.redundantDownloads, stats.decodes, stats.redundantDecodes);
+    log("LazyImageReplay: main thread stall %.1fms, peak memory %.1fMB",
+        stats.mainThreadStall * 1000, stats.peakMemory / (1024.0 * 1024.0));
+}
+
+#pragma mark - downloader stand-in
+
+void LazyImageReplay::createDownloadTask(const std::string &url, const std::string &storagePath, const std::string &identifier)
+{
+    Transfer transfer;
+    transfer.url = url;
+    transfer.storagePath = storagePath;
+    transfer.identifier = identifier;
+    transfer.sourcePath = _config.sourceDir + LazyImageLoader::getInstance()->convertURLToFilePath(url);
+    transfer.finishTime = 0;
+    _waitingTransfers.push_back(transfer);
+}
+
+void LazyImageReplay::startWaitingTransfers()
+{
+    double now = elapsedSeconds();
+    while(!_waitingTransfers.empty() && (int)_activeTransfers.size() < _config.maxProcessingTasks){
+        Transfer transfer = _waitingTransfers.front();
+        _waitingTransfers.pop_front();
+
+        double duration = _config.latency;
+        if(_config.bandwidth > 0){
+            long size = FileUtils::getInstance()->getFileSize(transfer.sourcePath);
+            if(size > 0){
+                duration += size / _config.bandwidth;
+            }
+        }
+        transfer.finishTime = now + duration;
+        _activeTransfers.push_back(transfer);
+    }
+}
+
+void LazyImageReplay::finishTransfer(const Transfer &transfer)
+{
+    network::DownloadTask task;
+    task.requestURL = transfer.url;
+    task.storagePath = transfer.storagePath;
+    task.identifier = transfer.identifier;
+
+    LazyImageLoader *loader = LazyImageLoader::getInstance();
+
+    Data data = FileUtils::getInstance()->getDataFromFile(transfer.sourcePath);
+    if(data.isNull()){
+        loader->onDownloadTaskFailed(task, network::DownloadTask::ERROR_FILE_OP_FAILED, 404, "not found in " + _config.sourceDir);
+        return;
+    }
+    if(!FileUtils::getInstance()->writeDataToFile(data, transfer.storagePath)){
+        loader->onDownloadTaskFailed(task, network::DownloadTask::ERROR_FILE_OP_FAILED, 0, "can not write " + transfer.storagePath);
+        return;
+    }
+
+    loader->onDownloadTaskDone(task);
+}
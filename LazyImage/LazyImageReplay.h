@@ -0,0 +1,112 @@
+/****************************************************************************
+ Copyright (c) 2016 QuanNguyen
+
+ http://quannguyen.info
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __Funny__LazyImageReplay__
+#define __Funny__LazyImageReplay__
+
+#include "cocos2d.h"
+#include "LazyImageTrace.h"
+
+#include <deque>
+
+class LazySprite;
+
+typedef struct LazyImageReplayConfig {
+
+    std::string tracePath;
+    std::string sourceDir;      // files served instead of network, same layout as LazyImageLoader::convertURLToFilePath
+    std::string holderImage;    // holder of replayed sprites
+    double latency;             // seconds before each request starts receiving
+    double bandwidth;           // bytes per second of each request, <= 0 is unlimited
+    int maxProcessingTasks;     // same as DownloaderHints::countOfMaxProcessingTasks
+    bool coldCache;             // remove cached images of traced urls before replay
+
+} LazyImageReplayConfig;
+
+/** Replay a trace written by LazyImageTrace against a local stand-in of Downloader.
+ *  Add it to an empty scene, replay starts on enter and onFinished is called with the stats.
+ *  It is not a standalone tool: LazySprite needs a running Director and GL context,
+ *  so run it inside the app (a hidden window is enough). Report is printed with log.
+ */
+class LazyImageReplay : public cocos2d::Node {
+protected:
+    LazyImageReplay();
+    virtual ~LazyImageReplay();
+
+public:
+    static LazyImageReplay* create(const LazyImageReplayConfig& config);
+    static LazyImageReplayConfig defaultConfig();
+
+    static void logReport(const LazyImageTraceStats& stats);
+
+    std::function<void(const LazyImageTraceStats& stats)> onFinished;
+
+protected:
+    virtual bool init(const LazyImageReplayConfig& config);
+    virtual void onEnter() override;
+    virtual void onExit() override;
+    virtual void update(float dt) override;
+
+private:
+    typedef struct Event {
+        char op;
+        long long time;         // milliseconds since replay start
+        int spriteId;
+        int urlId;
+        double cacheDuration;
+        cocos2d::Size size;
+    } Event;
+
+    typedef struct Transfer {
+        std::string url;
+        std::string storagePath;
+        std::string identifier;
+        std::string sourcePath;
+        double finishTime;      // seconds since replay start
+    } Transfer;
+
+    bool loadTrace(const std::string& path);
+    void runEvent(const Event& event);
+    double elapsedSeconds();
+
+    void createDownloadTask(const std::string& url, const std::string& storagePath, const std::string& identifier);
+    void startWaitingTransfers();
+    void finishTransfer(const Transfer& transfer);
+    void finish();
+
+private:
+    LazyImageReplayConfig _config;
+    std::vector<Event> _events;
+    size_t _nextEvent;
+    std::unordered_map<int, std::string> _urls;
+    cocos2d::Map<int, LazySprite *> _sprites;
+
+    std::deque<Transfer> _waitingTransfers;
+    std::vector<Transfer> _activeTransfers;
+
+    std::chrono::steady_clock::time_point _startTime;
+    bool _running;
+};
+
+#endif  /* defined(__Funny__LazyImageReplay__) */
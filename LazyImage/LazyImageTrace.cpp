@@ -0,0 +1,370 @@
+/****************************************************************************
+ Copyright (c) 2016 QuanNguyen
+
+ http://quannguyen.info
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#include "LazyImageTrace.h"
+
+#include "LazySprite.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if CC_TARGET_PLATFORM == CC_PLATFORM_IOS || CC_TARGET_PLATFORM == CC_PLATFORM_MAC
+#include <mach/mach.h>
+#elif CC_TARGET_PLATFORM == CC_PLATFORM_LINUX || CC_TARGET_PLATFORM == CC_PLATFORM_ANDROID
+#include <unistd.h>
+#endif
+
+USING_NS_CC;
+
+double LazyImageTraceStats::percentile(double p) const
+{
+    if(timeToDisplay.size() == 0){
+        return 0;
+    }
+
+    std::vector<double> sorted(timeToDisplay);
+    std::sort(sorted.begin(), sorted.end());
+
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    if(rank == 0){
+        rank = 1;
+    }
+    return sorted.at(std::min(rank, sorted.size()) - 1);
+}
+
+LazyImageTrace::LazyImageTrace()
+: _file(nullptr)
+, _collectingStats(false)
+, _lastEventTime(0)
+, _lastSpriteId(0)
+, _recordingIndex(0)
+, _workDepth(0)
+{
+    resetStats();
+}
+
+LazyImageTrace::~LazyImageTrace()
+{
+    stopRecording();
+}
+
+static LazyImageTrace* _sharedTrace = NULL;
+
+LazyImageTrace* LazyImageTrace::getInstance()
+{
+    if(_sharedTrace == NULL){
+        _sharedTrace = new LazyImageTrace();
+    }
+    return _sharedTrace;
+}
+
+#pragma mark - recording
+
+bool LazyImageTrace::startRecording(const std::string &path)
+{
+    stopRecording();
+
+    _file = fopen(path.c_str(), "w");
+    if(!_file){
+        CCLOG("LazyImageTrace: can not open %s", path.c_str());
+        return false;
+    }
+
+    fprintf(_file, "%s\n", LAZY_IMAGE_TRACE_HEADER);
+
+    _startTime = std::chrono::steady_clock::now();
+    _lastEventTime = 0;
+    _urlIds.clear();
+    _recordingIndex ++;
+
+    CCLOG("LazyImageTrace: recording to %s", path.c_str());
+    return true;
+}
+
+void LazyImageTrace::stopRecording()
+{
+    if(_file){
+        fclose(_file);
+        _file = nullptr;
+    }
+    if(!_collectingStats){
+        _pendingDisplays.clear();
+    }
+}
+
+long long LazyImageTrace::elapsedMilliseconds()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime).count();
+}
+
+void LazyImageTrace::writeEvent(char op, const std::string &args)
+{
+    long long now = elapsedMilliseconds();
+    fprintf(_file, "%c %lld %s\n", op, now - _lastEventTime, args.c_str());
+    _lastEventTime = now;
+}
+
+int LazyImageTrace::idForSprite(LazySprite *sprite)
+{
+    if(sprite->_traceId == 0){
+        sprite->_traceId = ++_lastSpriteId;
+    }
+
+    //sprite id is kept across recordings, declare it once per file
+    if(_file && sprite->_traceRecording != _recordingIndex){
+        sprite->_traceRecording = _recordingIndex;
+        writeEvent('n', StringUtils::format("%d %g %g", sprite->_traceId,
+                                            sprite->getImageSize().width, sprite->getImageSize().height));
+        //already on screen when recording started, its onEnter was not recorded
+        if(sprite->isRunning()){
+            writeEvent('e', StringUtils::format("%d", sprite->_traceId));
+        }
+    }
+    return sprite->_traceId;
+}
+
+int LazyImageTrace::idForURL(const std::string &url)
+{
+    auto ite = _urlIds.find(url);
+    if(ite != _urlIds.end()){
+        return ite->second;
+    }
+
+    int iden = (int)_urlIds.size() + 1;
+    _urlIds[url] = iden;
+    fprintf(_file, "u %d %s\n", iden, url.c_str());
+    return iden;
+}
+
+void LazyImageTrace::recordSetImageURL(LazySprite *sprite, const std::string &url, double cacheDuration)
+{
+    if(!isActive()){
+        return;
+    }
+
+    int spriteId = idForSprite(sprite);
+    if(_file){
+        int urlId = idForURL(url);
+        writeEvent('s', StringUtils::format("%d %d %g", spriteId, urlId, cacheDuration));
+    }
+
+    //same url is ignored by LazySprite, keep waiting for the first one
+    if(url != sprite->getImageURL()){
+        _pendingDisplays[spriteId] = std::make_pair(url, std::chrono::steady_clock::now());
+    }
+}
+
+void LazyImageTrace::recordReset(LazySprite *sprite)
+{
+    if(!isActive()){
+        return;
+    }
+
+    int spriteId = idForSprite(sprite);
+    if(_file){
+        writeEvent('r', StringUtils::format("%d", spriteId));
+    }
+    _pendingDisplays.erase(spriteId);
+}
+
+void LazyImageTrace::recordEnter(LazySprite *sprite)
+{
+    if(!_file){
+        return;
+    }
+
+    //first sight of a running sprite writes e itself
+    bool declared = sprite->_traceRecording == _recordingIndex;
+    int spriteId = idForSprite(sprite);
+    if(declared){
+        writeEvent('e', StringUtils::format("%d", spriteId));
+    }
+}
+
+void LazyImageTrace::recordExit(LazySprite *sprite)
+{
+    if(!_file){
+        return;
+    }
+    writeEvent('x', StringUtils::format("%d", idForSprite(sprite)));
+}
+
+void LazyImageTrace::recordLoadImage(const std::string &url, double cacheDuration)
+{
+    //calls made by LazySprite or by the loader itself are replayed through them
+    if(!_file || isInsideWork()){
+        return;
+    }
+
+    int urlId = idForURL(url);
+    writeEvent('l', StringUtils::format("%d %g", urlId, cacheDuration));
+}
+
+#pragma mark - stats
+
+void LazyImageTrace::setCollectingStats(bool collect)
+{
+    _collectingStats = collect;
+    if(!isActive()){
+        _pendingDisplays.clear();
+    }
+}
+
+LazyImageTraceStats LazyImageTrace::getStats() const
+{
+    return _stats;
+}
+
+void LazyImageTrace::resetStats()
+{
+    _stats.timeToDisplay.clear();
+    _stats.downloads = 0;
+    _stats.redundantDownloads = 0;
+    _stats.decodes = 0;
+    _stats.redundantDecodes = 0;
+    _stats.mainThreadStall = 0;
+    _stats.peakMemory = 0;
+
+    _downloadedURLs.clear();
+    _decodedURLs.clear();
+    _pendingDisplays.clear();
+}
+
+void LazyImageTrace::noteDownload(const std::string &url)
+{
+    if(!isActive()){
+        return;
+    }
+
+    _stats.downloads ++;
+    if(!_downloadedURLs.insert(url).second){
+        _stats.redundantDownloads ++;
+    }
+}
+
+void LazyImageTrace::noteDecode(const std::string &url)
+{
+    if(!isActive()){
+        return;
+    }
+
+    _stats.decodes ++;
+    if(!_decodedURLs.insert(url).second){
+        _stats.redundantDecodes ++;
+    }
+}
+
+void LazyImageTrace::noteDecodeForPath(const std::string &url, const std::string &path)
+{
+    if(!isActive()){
+        return;
+    }
+
+    std::string fullPath = FileUtils::getInstance()->fullPathForFilename(path);
+    if(Director::getInstance()->getTextureCache()->getTextureForKey(fullPath) == nullptr){
+        noteDecode(url);
+    }
+}
+
+void LazyImageTrace::noteDisplayed(LazySprite *sprite, const std::string &url)
+{
+    if(!isActive() || sprite->_traceId == 0){
+        return;
+    }
+
+    auto ite = _pendingDisplays.find(sprite->_traceId);
+    if(ite == _pendingDisplays.end() || ite->second.first != url){
+        return;
+    }
+
+    std::chrono::duration<double> waited = std::chrono::steady_clock::now() - ite->second.second;
+    _stats.timeToDisplay.push_back(waited.count());
+    _pendingDisplays.erase(ite);
+}
+
+void LazyImageTrace::forgetSprite(LazySprite *sprite)
+{
+    if(sprite->_traceId != 0){
+        _pendingDisplays.erase(sprite->_traceId);
+    }
+}
+
+void LazyImageTrace::enterWork()
+{
+    if(_workDepth == 0){
+        _workStartTime = std::chrono::steady_clock::now();
+    }
+    _workDepth ++;
+}
+
+void LazyImageTrace::leaveWork()
+{
+    if(_workDepth == 0){
+        return;
+    }
+
+    _workDepth --;
+    if(_workDepth == 0){
+        std::chrono::duration<double> spent = std::chrono::steady_clock::now() - _workStartTime;
+        _stats.mainThreadStall += spent.count();
+        sampleMemory();
+    }
+}
+
+void LazyImageTrace::sampleMemory()
+{
+    if(!isActive()){
+        return;
+    }
+
+    _stats.peakMemory = std::max(_stats.peakMemory, currentResidentMemory());
+}
+
+long LazyImageTrace::currentResidentMemory() const
+{
+    //current size, not ru_maxrss, so each session has its own peak
+#if CC_TARGET_PLATFORM == CC_PLATFORM_IOS || CC_TARGET_PLATFORM == CC_PLATFORM_MAC
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS){
+        return 0;
+    }
+    return (long)info.resident_size;
+#elif CC_TARGET_PLATFORM == CC_PLATFORM_LINUX || CC_TARGET_PLATFORM == CC_PLATFORM_ANDROID
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if(!statm){
+        return 0;
+    }
+    long pages = 0;
+    long residentPages = 0;
+    int fields = fscanf(statm, "%ld %ld", &pages, &residentPages);
+    fclose(statm);
+    if(fields != 2){
+        return 0;
+    }
+    return residentPages * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
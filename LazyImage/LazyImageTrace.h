@@ -0,0 +1,155 @@
+/****************************************************************************
+ Copyright (c) 2016 QuanNguyen
+
+ http://quannguyen.info
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __Funny__LazyImageTrace__
+#define __Funny__LazyImageTrace__
+
+#include "cocos2d.h"
+
+#include <chrono>
+#include <set>
+#include <unordered_map>
+
+class LazySprite;
+
+/** Trace file format, one event per line, text:
+ *  #lazyimage-trace 1
+ *  u <urlId> <url>                     declare url, before its first use
+ *  n <dt> <spriteId> <width> <height>  sprite seen for the first time
+ *  s <dt> <spriteId> <urlId> <cache>   LazySprite::setImageURL
+ *  r <dt> <spriteId>                   LazySprite::reset
+ *  e <dt> <spriteId>                   LazySprite::onEnter
+ *  x <dt> <spriteId>                   LazySprite::onExit
+ *  l <dt> <urlId> <cache>              LazyImageLoader::loadImage called by app code
+ *  dt is milliseconds since previous event.
+ */
+#define LAZY_IMAGE_TRACE_HEADER     "#lazyimage-trace 1"
+
+typedef struct LazyImageTraceStats {
+
+    std::vector<double> timeToDisplay;  // seconds, from setImageURL to image on screen
+    int downloads;
+    int redundantDownloads;             // url downloaded again in same session
+    int decodes;
+    int redundantDecodes;               // url decoded again in same session
+    double mainThreadStall;             // seconds spent inside loader/sprite work
+    long peakMemory;                    // bytes, highest resident size sampled since resetStats, 0 if unknown
+
+    /** nearest-rank percentile of timeToDisplay, p in [0, 100] */
+    double percentile(double p) const;
+
+} LazyImageTraceStats;
+
+class LazyImageTrace {
+protected:
+    LazyImageTrace();
+
+    virtual ~LazyImageTrace();
+
+public:
+    static LazyImageTrace* getInstance();
+
+public:
+    /** start writing calls to trace file
+     *  @params path full path of trace file, will be overwritten
+     *  @return false if file can not be opened
+     */
+    bool startRecording(const std::string& path);
+    void stopRecording();
+    bool isRecording() const { return _file != nullptr; }
+
+    /** collect stats without recording, used by LazyImageReplay */
+    void setCollectingStats(bool collect);
+    bool isActive() const { return _file != nullptr || _collectingStats; }
+
+    LazyImageTraceStats getStats() const;
+    void resetStats();
+
+    void recordSetImageURL(LazySprite *sprite, const std::string& url, double cacheDuration);
+    void recordReset(LazySprite *sprite);
+    void recordEnter(LazySprite *sprite);
+    void recordExit(LazySprite *sprite);
+    void recordLoadImage(const std::string& url, double cacheDuration);
+
+    void noteDownload(const std::string& url);
+    void noteDecode(const std::string& url);
+    /** count as decode only if texture of path is not in TextureCache yet */
+    void noteDecodeForPath(const std::string& url, const std::string& path);
+    void noteDisplayed(LazySprite *sprite, const std::string& url);
+    void forgetSprite(LazySprite *sprite);
+
+    /** main thread work, nested calls are counted once */
+    void enterWork();
+    void leaveWork();
+    bool isInsideWork() const { return _workDepth > 0; }
+
+    /** sample resident size of process into peakMemory, also done after each main thread work */
+    void sampleMemory();
+
+private:
+    int idForSprite(LazySprite *sprite);
+    int idForURL(const std::string& url);
+    long long elapsedMilliseconds();
+    void writeEvent(char op, const std::string& args);
+    long currentResidentMemory() const;
+
+private:
+    FILE *_file;
+    bool _collectingStats;
+    std::chrono::steady_clock::time_point _startTime;
+    long long _lastEventTime;
+    std::unordered_map<std::string, int> _urlIds;
+    int _lastSpriteId;
+    int _recordingIndex;
+
+    // stats
+    LazyImageTraceStats _stats;
+    std::set<std::string> _downloadedURLs;
+    std::set<std::string> _decodedURLs;
+    std::unordered_map<int, std::pair<std::string, std::chrono::steady_clock::time_point>> _pendingDisplays;
+    int _workDepth;
+    std::chrono::steady_clock::time_point _workStartTime;
+};
+
+/** scope helper for LazyImageTrace::enterWork/leaveWork, no-op when trace is not active */
+class LazyImageTraceScope {
+public:
+    LazyImageTraceScope()
+    : _active(LazyImageTrace::getInstance()->isActive())
+    {
+        if(_active){
+            LazyImageTrace::getInstance()->enterWork();
+        }
+    }
+    ~LazyImageTraceScope()
+    {
+        if(_active){
+            LazyImageTrace::getInstance()->leaveWork();
+        }
+    }
+private:
+    bool _active;
+};
+
+#endif  /* defined(__Funny__LazyImageTrace__) */
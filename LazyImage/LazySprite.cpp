@@ -25,18 +25,22 @@
 #include "LazySprite.h"
 
 #include "LazyImageLoader.h"
+#include "LazyImageTrace.h"
 
 USING_NS_CC;
 
 LazySprite::LazySprite()
 : _holderSprite(nullptr)
 , _loadImageListener(nullptr)
+, _traceId(0)
+, _traceRecording(0)
 {
     
 }
 
 LazySprite::~LazySprite()
 {
+    LazyImageTrace::getInstance()->forgetSprite(this);
     CC_SAFE_RELEASE_NULL(_holderSprite);
 }
 
@@ -73,19 +77,25 @@ bool LazySprite::init(Sprite *holder, const cocos2d::Size& s)
 void LazySprite::setImageURL(const std::string &url,double cacheDuration)
 {
     CCLOG("LazySprite::setImageURL: %s", url.c_str());
+    LazyImageTraceScope traceScope;
+    LazyImageTrace::getInstance()->recordSetImageURL(this, url, cacheDuration);
     if(url == _imgURL){
         return;
     }
     
     _imgURL = url;
+    //smaller variant for _imageSize if server can resize
+    _loadURL = LazyImageLoader::getInstance()->resolveURL(url, _imageSize);
     
-    std::string path = LazyImageLoader::getInstance()->pathForLoadedImage(url);
+    std::string path = LazyImageLoader::getInstance()->pathForLoadedImage(_loadURL);
     if(path.length() != 0){
+        LazyImageTrace::getInstance()->noteDecodeForPath(_loadURL, path);
         Sprite *s = Sprite::create(path);
         setSpriteFrame(s->getSpriteFrame());
         resetScaleBySize(s->getBoundingBox().size);
+        LazyImageTrace::getInstance()->noteDisplayed(this, url);
         //increase cache time for this image
-        LazyImageLoader::getInstance()->saveCacheInfo(url, cacheDuration);
+        LazyImageLoader::getInstance()->saveCacheInfo(_loadURL, cacheDuration);
         return;
     }
     
@@ -94,26 +104,29 @@ void LazySprite::setImageURL(const std::string &url,double cacheDuration)
     resetScaleBySize(_holderSprite->getContentSize());
     
     //request load image
-    LazyImageLoader::getInstance()->loadImage(url);
+    LazyImageLoader::getInstance()->loadImage(_loadURL);
 }
 
 void LazySprite::reset()
 {
+    LazyImageTrace::getInstance()->recordReset(this);
     setSpriteFrame(_holderSprite->getSpriteFrame());
     resetScaleBySize(_holderSprite->getContentSize());
     _imgURL = "";
+    _loadURL = "";
 }
 
 void LazySprite::onLoadSpriteDone(cocos2d::Event *obj)
 {
     CCLOG("LazySprite: recieve notification onload sprite done");
+    LazyImageTraceScope traceScope;
     
     ImageLoaderEvent *eventCustom = dynamic_cast<ImageLoaderEvent *> (obj);
     if(!eventCustom){
         return;
     }
     std::string url = eventCustom->getURL();
-    if(url != _imgURL){
+    if(url != _loadURL){
         return;
     }
     //update sprite
@@ -124,6 +137,7 @@ void LazySprite::onLoadSpriteDone(cocos2d::Event *obj)
         //update to sprite
         setSpriteFrame(s->getSpriteFrame());
         resetScaleBySize(s->getBoundingBox().size);
+        LazyImageTrace::getInstance()->noteDisplayed(this, _imgURL);
     }
 }
 
@@ -140,6 +154,8 @@ void LazySprite::onEnter()
 {
     Sprite::onEnter();
     
+    LazyImageTrace::getInstance()->recordEnter(this);
+    
     //register notification
     EventListenerCustom *listener = EventListenerCustom::create(EVENT_LAZY_IMAGE_DONE, CC_CALLBACK_1(LazySprite::onLoadSpriteDone, this));
     getEventDispatcher()->addEventListenerWithSceneGraphPriority(listener, this);
@@ -151,19 +167,24 @@ void LazySprite::onEnterTransitionDidFinish()
 {
     Sprite::onEnterTransitionDidFinish();
     
-    if(_imgURL.size() != 0){
-        std::string path = LazyImageLoader::getInstance()->pathForLoadedImage(_imgURL);
+    LazyImageTraceScope traceScope;
+    if(_loadURL.size() != 0){
+        std::string path = LazyImageLoader::getInstance()->pathForLoadedImage(_loadURL);
         if(path.size() != 0){
+            LazyImageTrace::getInstance()->noteDecodeForPath(_loadURL, path);
             Sprite *s = Sprite::create(path);
             //update to sprite
             setSpriteFrame(s->getSpriteFrame());
             resetScaleBySize(s->getBoundingBox().size);
+            LazyImageTrace::getInstance()->noteDisplayed(this, _imgURL);
         }
     }
 }
 
 void LazySprite::onExit()
 {
+    LazyImageTrace::getInstance()->recordExit(this);
+    
     if(_loadImageListener){
         getEventDispatcher()->removeEventListener(_loadImageListener);
         _loadImageListener = nullptr;
@@ -28,6 +28,7 @@
 #include "cocos2d.h"
 
 class LazySprite : public cocos2d::Sprite {
+    friend class LazyImageTrace;
 protected:
     LazySprite();
     virtual ~LazySprite();
@@ -52,6 +53,9 @@ private:
 private:
     cocos2d::Sprite *_holderSprite;
     cocos2d::EventListenerCustom *_loadImageListener;
+    std::string _loadURL;   // _imgURL or its size variant
+    int _traceId;
+    int _traceRecording;
 };
 
 #endif /* defined(__Funny__LazySprite__) */